@@ -6,6 +6,8 @@
 #include <freertos/semphr.h>
 #include <driver/i2s.h>
 
+#include <audio_latency.h>
+
 #include <sys/time.h>
 #include <memory>
 #include <vector>
@@ -17,8 +19,10 @@ typedef struct audio_sample_buffer
 {
     struct timeval timestamp;
     std::vector<mono_sample_t> samples;
+    audio_trace_t trace;
 
     audio_sample_buffer(size_t size);
+    void stamp(audio_trace_point_t point);
 } audio_sample_buffer_t;
 
 class audio_capture
@@ -29,11 +33,16 @@ private:
 
     QueueHandle_t sample_queue_;
     TaskHandle_t task_handle_;
+    dma_ring_tracker dma_ring_;
+
+    int64_t dma_complete_time(int64_t read_time);
 
 protected:
     typedef ushort esp32_i2s_sample_t;
 
     i2s_port_t i2s_port_;
+    // I2S driver events, one I2S_EVENT_RX_DONE per completed DMA buffer. Install the driver with DMA_RX_BUFFERS events
+    QueueHandle_t i2s_event_queue_;
     float seconds_per_buffer_;
     uint sample_rate_;
     ushort samples_per_buffer_;
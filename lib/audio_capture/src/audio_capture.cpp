@@ -1,24 +1,28 @@
 #include <esp32-hal-log.h>
+#include <esp_timer.h>
 #include <audio_capture.h>
 
-// Number of queues
-#define SAMPLE_BUFFER_NUM_QUEUES 2
-
 audio_sample_buffer::audio_sample_buffer(size_t size)
 {
     samples = std::vector<mono_sample_t>(size);
     gettimeofday(&timestamp, nullptr);
 }
 
+void audio_sample_buffer::stamp(audio_trace_point_t point)
+{
+    trace.points[point] = esp_timer_get_time();
+}
+
 audio_capture::audio_capture(i2s_port_t i2s_port, float seconds_per_buffer /*= 0.016f*/, uint sample_rate /*= 16000*/, i2s_channel_t channels /*= I2S_CHANNEL_MONO*/, ushort bits_per_sample /*= 16*/)
-    : i2s_port_(i2s_port), seconds_per_buffer_(seconds_per_buffer), sample_rate_(sample_rate), channels_(channels), bits_per_sample_(bits_per_sample)
+    : dma_ring_(DMA_RX_BUFFERS, 0), i2s_port_(i2s_port), i2s_event_queue_(nullptr), seconds_per_buffer_(seconds_per_buffer), sample_rate_(sample_rate), channels_(channels), bits_per_sample_(bits_per_sample)
 {
     samples_per_buffer_ = sample_rate * seconds_per_buffer_;
-    if (samples_per_buffer_ > 1024)
-        log_e("DMA buffer must not exceed 1024 samples. Currently: %d", samples_per_buffer_);
+    if (samples_per_buffer_ > DMA_MAX_SAMPLES_PER_BUFFER)
+        log_e("DMA buffer must not exceed %d samples. Currently: %d", DMA_MAX_SAMPLES_PER_BUFFER, samples_per_buffer_);
 
     log_i("Sample rate: %ud Hz. Seconds per buffer: %f. Channels: %d. Bits per sample: %d.", sample_rate_, seconds_per_buffer_, channels_, bits_per_sample_);
     log_i("Calculated samples per buffer: %d", samples_per_buffer_);
+    dma_ring_.set_period((int64_t)samples_per_buffer_ * 1000000 / sample_rate_);
 
     // Create the sample queue of pointers to buffers
     sample_queue_ = xQueueCreate(SAMPLE_BUFFER_NUM_QUEUES, sizeof(audio_sample_buffer_t *));
@@ -52,8 +56,11 @@ void audio_capture::record_task()
         log_d("Reading samples from I2S");
         size_t i2s_bytes_read;
         ESP_ERROR_CHECK(i2s_read(i2s_port_, esp32_raw_samples, samples_per_buffer_ * sizeof(esp32_i2s_sample_t), &i2s_bytes_read, portMAX_DELAY));
+        auto read_time = esp_timer_get_time();
         size_t samples_read = i2s_bytes_read / sizeof(esp32_i2s_sample_t);
         auto samples = new audio_sample_buffer_t(samples_read);
+        samples->trace.points[TRACE_DMA_COMPLETE] = dma_complete_time(read_time);
+        samples->trace.points[TRACE_READ] = read_time;
         // Get left channel in buffer
         log_d("Normalizing raw samples");
         convert_from_raw_samples(esp32_raw_samples, samples->samples.data(), samples_read);
@@ -67,6 +74,27 @@ void audio_capture::record_task()
     vTaskDelete(nullptr);
 }
 
+int64_t audio_capture::dma_complete_time(int64_t read_time)
+{
+    if (!i2s_event_queue_)
+        return read_time;
+
+    // Count the buffers completed since the last read
+    i2s_event_t event;
+    while (xQueueReceive(i2s_event_queue_, &event, 0) == pdTRUE)
+    {
+        if (event.type == I2S_EVENT_RX_DONE)
+            dma_ring_.completed();
+        else
+        {
+            log_w("I2S event %d", event.type);
+            dma_ring_.overflowed();
+        }
+    }
+
+    return dma_ring_.read(read_time);
+}
+
 void audio_capture::start(int stack_size /*= 2048*/, UBaseType_t priority /*= 5*/)
 {
     log_i("Starting recording");
@@ -76,6 +104,8 @@ void audio_capture::start(int stack_size /*= 2048*/, UBaseType_t priority /*= 5*
 
 void audio_capture::push_samples(audio_sample_buffer_t *sample_buffer)
 {
+    // Stamp before sending; once queued the buffer is owned by the consumer
+    sample_buffer->stamp(TRACE_ENQUEUED);
     // Wait until queued. No timeout
     xQueueSend(sample_queue_, &sample_buffer, portMAX_DELAY);
     log_d("Send %d samples to queue. ts=%d.%d", sample_buffer->samples.size(), sample_buffer->timestamp.tv_sec, sample_buffer->timestamp.tv_usec);
@@ -85,7 +115,10 @@ std::unique_ptr<audio_sample_buffer_t> audio_capture::pop_samples(uint ticks_to_
 {
     audio_sample_buffer_t *sample_buffer = nullptr;
     if (xQueueReceive(sample_queue_, &sample_buffer, ticks_to_wait) == pdTRUE)
+    {
+        sample_buffer->stamp(TRACE_DEQUEUED);
         log_d("Retrieved %d samples from queue. ts=%d.d", sample_buffer->samples.size(), sample_buffer->timestamp.tv_sec, sample_buffer->timestamp.tv_usec);
+    }
     else
         log_w("Unable to retrieve samples");
 
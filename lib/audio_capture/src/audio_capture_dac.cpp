@@ -1,8 +1,6 @@
 #include <esp32-hal-log.h>
 #include <audio_capture_dac.h>
 
-#define DMA_BUFFERS 4
-
 audio_capture_dac::audio_capture_dac(i2s_port_t i2s_port, adc1_channel_t adc1_channel, float seconds_per_buffer /*= 0.016*/, size_t sample_rate /*= 16000*/, i2s_channel_t channels /*= I2S_CHANNEL_MONO*/, ushort bits_per_sample /*= 16*/)
     : audio_capture(i2s_port, seconds_per_buffer, sample_rate, channels, bits_per_sample)
 {
@@ -20,7 +18,7 @@ audio_capture_dac::audio_capture_dac(i2s_port_t i2s_port, adc1_channel_t adc1_ch
       .fixed_mclk = 0};
 
   // Install I2S driver
-  ESP_ERROR_CHECK(i2s_driver_install(i2s_port_, &i2s_config, 0, nullptr));
+  ESP_ERROR_CHECK(i2s_driver_install(i2s_port_, &i2s_config, DMA_RX_BUFFERS, &i2s_event_queue_));
   ESP_ERROR_CHECK(i2s_set_adc_mode(ADC_UNIT_1, adc1_channel));
   // Enable the adc
   ESP_ERROR_CHECK(i2s_adc_enable(i2s_port_));
@@ -1,7 +1,6 @@
 #include <esp32-hal-log.h>
 #include <audio_capture_mems.h>
 
-#define DMA_BUFFERS 4
 #define IS_SPH0645 false
 
 audio_capture_mems::audio_capture_mems(i2s_port_t i2s_port, i2s_pin_config_t pin_config, float seconds_per_buffer /*= 0.064*/, size_t sample_rate /*= 16000*/, i2s_channel_t channels /*= I2S_CHANNEL_MONO*/, ushort bits_per_sample /*= 16*/)
@@ -21,7 +20,7 @@ audio_capture_mems::audio_capture_mems(i2s_port_t i2s_port, i2s_pin_config_t pin
       .fixed_mclk = 0};
 
   // Install I2S driver
-  ESP_ERROR_CHECK(i2s_driver_install(i2s_port_, &i2s_config, 0, nullptr));
+  ESP_ERROR_CHECK(i2s_driver_install(i2s_port_, &i2s_config, DMA_RX_BUFFERS, &i2s_event_queue_));
   if (IS_SPH0645)
   {
     // Fixes for SPH0645
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <audio_trace.h>
+
+#include <string>
+
+// Linear sub buckets per power of 2 (2^4 = 16): relative resolution of 1/16
+#define LATENCY_HISTOGRAM_SUB_BUCKET_BITS 4
+// Largest tracked value 2^24 microseconds (~16.8 seconds). Larger values are counted in the last bucket
+#define LATENCY_HISTOGRAM_MAX_BITS 24
+#define LATENCY_HISTOGRAM_BUCKETS ((LATENCY_HISTOGRAM_MAX_BITS - LATENCY_HISTOGRAM_SUB_BUCKET_BITS + 1) << LATENCY_HISTOGRAM_SUB_BUCKET_BITS)
+// Number of stages in audio_latency::stages
+#define LATENCY_STAGES 6
+
+// Log linear (HDR style) histogram of microseconds. Values below 2 * 16 have a bucket each,
+// above that every power of 2 is split in 16 equal buckets
+class latency_histogram
+{
+private:
+    uint32_t buckets_[LATENCY_HISTOGRAM_BUCKETS];
+    uint32_t count_;
+    int64_t sum_;
+    int64_t min_;
+    int64_t max_;
+
+public:
+    latency_histogram();
+
+    static size_t get_bucket(int64_t microseconds);
+    static int64_t get_bucket_lower(size_t bucket);
+    static int64_t get_bucket_width(size_t bucket);
+
+    void reset();
+    void add(int64_t microseconds);
+
+    uint32_t get_count() const { return count_; };
+    int64_t get_min() const { return count_ ? min_ : 0; };
+    int64_t get_max() const { return max_; };
+    int64_t get_mean() const { return count_ ? sum_ / count_ : 0; };
+    // Estimate (microseconds), interpolated within the bucket containing the percentile
+    int64_t get_percentile(float percentile) const;
+};
+
+// Counts the DMA buffers completed but not read yet, from the I2S driver events, to estimate
+// when the buffer being read completed. Drain all driver events before each read
+class dma_ring_tracker
+{
+private:
+    // Completed buffers the driver keeps, older ones are dropped
+    size_t depth_;
+    int64_t period_;
+    size_t pending_;
+
+public:
+    dma_ring_tracker(size_t depth, int64_t period_microseconds);
+
+    // I2S_EVENT_RX_DONE: a DMA buffer completed
+    void completed();
+    // Any other event (overflow, error): completed buffers were dropped, the ring is full
+    void overflowed();
+    // The oldest pending buffer was read at read_time. Returns the latest it can have completed
+    int64_t read(int64_t read_time);
+
+    size_t get_pending() const { return pending_; };
+    void set_period(int64_t period_microseconds) { period_ = period_microseconds; };
+};
+
+// Aggregates the trace points of sample buffers (see audio_trace.h) into a histogram per pipeline stage.
+// Not thread safe: record and report from the same task.
+class audio_latency
+{
+public:
+    typedef struct
+    {
+        const char *name;
+        audio_trace_point_t from;
+        audio_trace_point_t to;
+    } stage_t;
+
+    // Constant initialized, so usable from constructors of other globals
+    static const stage_t stages[LATENCY_STAGES];
+
+private:
+    latency_histogram histograms_[LATENCY_STAGES];
+
+public:
+    void reset();
+    void record(const audio_trace_t &trace);
+
+    const latency_histogram &get_histogram(size_t stage) const { return histograms_[stage]; };
+
+    std::string report() const;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+// Pipeline dimensions, shared by audio_capture and the host benchmark
+
+// Number of I2S DMA buffers
+#define DMA_BUFFERS 4
+// Completed DMA buffers the I2S driver keeps for reading (its RX queue holds dma_buf_count - 1)
+#define DMA_RX_BUFFERS (DMA_BUFFERS - 1)
+// Maximum number of samples in a DMA buffer
+#define DMA_MAX_SAMPLES_PER_BUFFER 1024
+// Number of queues
+#define SAMPLE_BUFFER_NUM_QUEUES 2
+
+// Points in the pipeline a sample buffer is stamped at, in the order they are passed
+typedef enum
+{
+    TRACE_DMA_COMPLETE, // I2S DMA buffer filled (estimated from the pending DMA buffers)
+    TRACE_READ,         // Copied out of the I2S DMA buffer
+    TRACE_ENQUEUED,     // Handed to the sample queue
+    TRACE_DEQUEUED,     // Taken from the sample queue
+    TRACE_SENT,         // Written to the client
+    TRACE_PROCESSED,    // Processing (FFT) done
+    TRACE_MAX
+} audio_trace_point_t;
+
+typedef struct audio_trace
+{
+    // Microseconds at each trace point, 0 if not (yet) passed
+    int64_t points[TRACE_MAX];
+
+    audio_trace() : points() {}
+} audio_trace_t;
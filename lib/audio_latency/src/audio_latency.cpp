@@ -0,0 +1,167 @@
+#include <audio_latency.h>
+
+#include <algorithm>
+#include <limits>
+#include <stdio.h>
+
+const audio_latency::stage_t audio_latency::stages[LATENCY_STAGES] = {
+    {"dma->read", TRACE_DMA_COMPLETE, TRACE_READ},
+    {"read->enqueue", TRACE_READ, TRACE_ENQUEUED},
+    {"enqueue->dequeue", TRACE_ENQUEUED, TRACE_DEQUEUED},
+    {"dequeue->sent", TRACE_DEQUEUED, TRACE_SENT},
+    {"sent->processed", TRACE_SENT, TRACE_PROCESSED},
+    {"dma->sent", TRACE_DMA_COMPLETE, TRACE_SENT}};
+
+latency_histogram::latency_histogram()
+{
+    reset();
+}
+
+void latency_histogram::reset()
+{
+    std::fill(buckets_, buckets_ + LATENCY_HISTOGRAM_BUCKETS, 0);
+    count_ = 0;
+    sum_ = 0;
+    min_ = std::numeric_limits<int64_t>::max();
+    max_ = 0;
+}
+
+size_t latency_histogram::get_bucket(int64_t microseconds)
+{
+    const int64_t sub_buckets = 1 << LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+    if (microseconds < 2 * sub_buckets)
+        return microseconds < 0 ? 0 : microseconds;
+
+    if (microseconds >= (int64_t)1 << LATENCY_HISTOGRAM_MAX_BITS)
+        return LATENCY_HISTOGRAM_BUCKETS - 1;
+
+    // Shift the value so its top bits select one of the sub buckets of its power of 2
+    size_t shift = 0;
+    while ((microseconds >> shift) >= 2 * sub_buckets)
+        shift++;
+
+    return ((shift + 1) << LATENCY_HISTOGRAM_SUB_BUCKET_BITS) + (microseconds >> shift) - sub_buckets;
+}
+
+int64_t latency_histogram::get_bucket_lower(size_t bucket)
+{
+    const size_t sub_buckets = 1 << LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+    if (bucket < 2 * sub_buckets)
+        return bucket;
+
+    auto shift = (bucket >> LATENCY_HISTOGRAM_SUB_BUCKET_BITS) - 1;
+    return (int64_t)(sub_buckets + (bucket & (sub_buckets - 1))) << shift;
+}
+
+int64_t latency_histogram::get_bucket_width(size_t bucket)
+{
+    const size_t sub_buckets = 1 << LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+    if (bucket < 2 * sub_buckets)
+        return 1;
+
+    return (int64_t)1 << ((bucket >> LATENCY_HISTOGRAM_SUB_BUCKET_BITS) - 1);
+}
+
+void latency_histogram::add(int64_t microseconds)
+{
+    if (microseconds < 0)
+        microseconds = 0;
+
+    buckets_[get_bucket(microseconds)]++;
+    count_++;
+    sum_ += microseconds;
+    min_ = std::min(min_, microseconds);
+    max_ = std::max(max_, microseconds);
+}
+
+int64_t latency_histogram::get_percentile(float percentile) const
+{
+    if (!count_)
+        return 0;
+
+    // Rank of the sample at the percentile, 1 based
+    auto rank = std::max((uint32_t)1, (uint32_t)(count_ * percentile / 100 + 0.5f));
+    rank = std::min(rank, count_);
+    uint32_t seen = 0;
+    for (size_t bucket = 0; bucket < LATENCY_HISTOGRAM_BUCKETS; bucket++)
+    {
+        if (seen + buckets_[bucket] >= rank)
+        {
+            // Assume the values are spread evenly over the bucket, take the middle of the rank's share
+            auto value = get_bucket_lower(bucket) + get_bucket_width(bucket) * (2 * (rank - seen) - 1) / (2 * buckets_[bucket]);
+            return std::max(min_, std::min(value, max_));
+        }
+
+        seen += buckets_[bucket];
+    }
+
+    return max_;
+}
+
+dma_ring_tracker::dma_ring_tracker(size_t depth, int64_t period_microseconds)
+    : depth_(depth), period_(period_microseconds), pending_(0)
+{
+}
+
+void dma_ring_tracker::completed()
+{
+    // The driver drops the oldest buffer (and its event) when full
+    pending_ = std::min(pending_ + 1, depth_);
+}
+
+void dma_ring_tracker::overflowed()
+{
+    pending_ = depth_;
+}
+
+int64_t dma_ring_tracker::read(int64_t read_time)
+{
+    // Event of the buffer read not seen yet
+    if (!pending_)
+        return read_time;
+
+    // The buffers still pending completed after the one read, one period apart
+    pending_--;
+    return read_time - (int64_t)pending_ * period_;
+}
+
+void audio_latency::reset()
+{
+    for (auto &histogram : histograms_)
+        histogram.reset();
+}
+
+void audio_latency::record(const audio_trace_t &trace)
+{
+    for (size_t stage = 0; stage < LATENCY_STAGES; stage++)
+    {
+        auto from = trace.points[stages[stage].from];
+        auto to = trace.points[stages[stage].to];
+        // Skip stages the buffer has not passed
+        if (from && to)
+            histograms_[stage].add(to - from);
+    }
+}
+
+std::string audio_latency::report() const
+{
+    std::string report;
+    char line[128];
+    snprintf(line, sizeof(line), "%-18s %8s %10s %10s %10s %10s %10s\n", "stage (us)", "count", "min", "mean", "p50", "p99", "max");
+    report += line;
+    for (size_t stage = 0; stage < LATENCY_STAGES; stage++)
+    {
+        const auto &histogram = histograms_[stage];
+        snprintf(line, sizeof(line), "%-18s %8u %10lld %10lld %10lld %10lld %10lld\n",
+                 stages[stage].name,
+                 (unsigned)histogram.get_count(),
+                 (long long)histogram.get_min(),
+                 (long long)histogram.get_mean(),
+                 (long long)histogram.get_percentile(50),
+                 (long long)histogram.get_percentile(99),
+                 (long long)histogram.get_max());
+        report += line;
+    }
+
+    return report;
+}
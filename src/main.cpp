@@ -3,6 +3,7 @@
 #include <.settings.h>
 
 #include "soc/rtc_cntl_reg.h"
+#include <esp_timer.h>
 #include <WiFi.h>
 #include <ESPmDNS.h>
 
@@ -12,6 +13,7 @@
 
 #include <audio_capture_mems.h>
 #include <audio_capture_dac.h>
+#include <audio_latency.h>
 
 #include <ArduinoOTA.h>
 
@@ -32,6 +34,8 @@ const i2s_pin_config_t inmp441_pin_config = {
 // Capture instance
 //audio_capture_mems capture(I2S_NUM_PORT, inmp441_pin_config);
 audio_capture_dac capture(I2S_NUM_PORT, ANALOG_ADC1_CHANNEL);
+// Latency of the sample buffers through the pipeline
+audio_latency latency;
 
 void handle_not_found()
 {
@@ -59,6 +63,12 @@ void handle_audio()
   if (wifi_client.write(wav_header.data(), wav_header.size()) != wav_header.size())
     return;
 
+  // Buffers captured before the stream started (queued, blocked on the queue or still in
+  // the DMA ring) are streamed but not counted for latency
+  auto stream_start = esp_timer_get_time();
+  // Report the latency of this stream only
+  latency.reset();
+
   while (wifi_client.connected())
   {
     // Get samples
@@ -67,6 +77,7 @@ void handle_audio()
     {
       // Write raw PCM
       wifi_client.write((const char *)sample_buffer->samples.data(), sample_buffer->samples.size() * sizeof(mono_sample_t));
+      sample_buffer->stamp(TRACE_SENT);
 
       std::vector<double> vReal(sample_buffer->samples.size());
       std::vector<double> vImag(sample_buffer->samples.size());
@@ -79,6 +90,9 @@ void handle_audio()
       fft.Windowing(FFT_WIN_TYP_HAMMING, FFT_FORWARD);
       fft.Compute(FFT_FORWARD);
       auto peak = fft.MajorPeak();
+      sample_buffer->stamp(TRACE_PROCESSED);
+      if (sample_buffer->trace.points[TRACE_DMA_COMPLETE] >= stream_start)
+        latency.record(sample_buffer->trace);
       log_i("FFT peak at %f Hz", peak);
       telnet.printf("FFT peak at %f Hz\n", peak);
     }
@@ -87,6 +101,17 @@ void handle_audio()
   }
 }
 
+void handle_latency()
+{
+  // Served from the same task as handle_audio, so between streams: reports the last stream. Add ?reset to clear after reporting
+  // Samples in a buffer are already up to one buffer old when the DMA completes
+  char header[160];
+  snprintf(header, sizeof(header), "Sample rate: %u Hz. Samples per buffer: %u (%.1f ms). DMA buffers: %d. Queue length: %d\n\n", capture.get_sample_rate(), capture.get_samples_per_buffer(), capture.get_seconds_per_buffer() * 1000, DMA_BUFFERS, SAMPLE_BUFFER_NUM_QUEUES);
+  web_server.send(200, "text/plain", String(header) + latency.report().c_str());
+  if (web_server.hasArg("reset"))
+    latency.reset();
+}
+
 void setup()
 {
   // Disable brownout
@@ -189,6 +214,7 @@ void setup()
 
   web_server.on("/", handle_root);
   web_server.on("/audio", handle_audio);
+  web_server.on("/latency", handle_latency);
   web_server.onNotFound(handle_not_found);
 
   web_server.begin();
@@ -0,0 +1,230 @@
+#include <unity.h>
+
+#include <audio_latency.h>
+
+void setUp() {}
+void tearDown() {}
+
+void test_bucket_boundaries()
+{
+    // Below 2 * 16 every value has its own bucket
+    for (int64_t value = 0; value < 32; value++)
+    {
+        TEST_ASSERT_EQUAL(value, latency_histogram::get_bucket(value));
+        TEST_ASSERT_EQUAL(value, latency_histogram::get_bucket_lower(value));
+        TEST_ASSERT_EQUAL(1, latency_histogram::get_bucket_width(value));
+    }
+
+    // From 32 on the buckets widen per power of 2
+    TEST_ASSERT_EQUAL(32, latency_histogram::get_bucket(32));
+    TEST_ASSERT_EQUAL(32, latency_histogram::get_bucket(33));
+    TEST_ASSERT_EQUAL(33, latency_histogram::get_bucket(34));
+    TEST_ASSERT_EQUAL(2, latency_histogram::get_bucket_width(32));
+    TEST_ASSERT_EQUAL(48, latency_histogram::get_bucket(64));
+    TEST_ASSERT_EQUAL(4, latency_histogram::get_bucket_width(48));
+
+    // Negative values go into the first, too large values into the last bucket
+    TEST_ASSERT_EQUAL(0, latency_histogram::get_bucket(-1));
+    TEST_ASSERT_EQUAL(LATENCY_HISTOGRAM_BUCKETS - 1, latency_histogram::get_bucket((int64_t)1 << LATENCY_HISTOGRAM_MAX_BITS));
+    TEST_ASSERT_EQUAL(LATENCY_HISTOGRAM_BUCKETS - 1, latency_histogram::get_bucket(((int64_t)1 << LATENCY_HISTOGRAM_MAX_BITS) - 1));
+
+    // Buckets are contiguous and contain the values mapped to them
+    for (size_t bucket = 0; bucket < LATENCY_HISTOGRAM_BUCKETS - 1; bucket++)
+    {
+        auto lower = latency_histogram::get_bucket_lower(bucket);
+        auto upper = lower + latency_histogram::get_bucket_width(bucket);
+        TEST_ASSERT_EQUAL(upper, latency_histogram::get_bucket_lower(bucket + 1));
+        TEST_ASSERT_EQUAL(bucket, latency_histogram::get_bucket(lower));
+        TEST_ASSERT_EQUAL(bucket, latency_histogram::get_bucket(upper - 1));
+    }
+
+    // One and a half buffer period apart must be told apart
+    TEST_ASSERT_NOT_EQUAL(latency_histogram::get_bucket(16000), latency_histogram::get_bucket(24000));
+}
+
+void test_empty_histogram()
+{
+    latency_histogram histogram;
+    TEST_ASSERT_EQUAL(0, histogram.get_count());
+    TEST_ASSERT_EQUAL(0, histogram.get_min());
+    TEST_ASSERT_EQUAL(0, histogram.get_mean());
+    TEST_ASSERT_EQUAL(0, histogram.get_max());
+    TEST_ASSERT_EQUAL(0, histogram.get_percentile(50));
+    TEST_ASSERT_EQUAL(0, histogram.get_percentile(99));
+}
+
+void test_statistics()
+{
+    latency_histogram histogram;
+    histogram.add(100);
+    histogram.add(200);
+    histogram.add(600);
+    TEST_ASSERT_EQUAL(3, histogram.get_count());
+    TEST_ASSERT_EQUAL(100, histogram.get_min());
+    TEST_ASSERT_EQUAL(300, histogram.get_mean());
+    TEST_ASSERT_EQUAL(600, histogram.get_max());
+}
+
+void test_percentile_exact()
+{
+    // Small values have buckets of width 1, so percentiles are exact
+    latency_histogram histogram;
+    for (int64_t value = 1; value <= 20; value++)
+        histogram.add(value);
+
+    TEST_ASSERT_EQUAL(10, histogram.get_percentile(50));
+    TEST_ASSERT_EQUAL(20, histogram.get_percentile(99));
+    TEST_ASSERT_EQUAL(20, histogram.get_percentile(100));
+    TEST_ASSERT_EQUAL(1, histogram.get_percentile(0));
+}
+
+void test_percentile_uniform()
+{
+    latency_histogram histogram;
+    for (int64_t value = 16001; value <= 17000; value++)
+        histogram.add(value);
+
+    // Within the resolution of a bucket (1/16)
+    TEST_ASSERT_INT_WITHIN(16500 / 16, 16500, histogram.get_percentile(50));
+    TEST_ASSERT_INT_WITHIN(16990 / 16, 16990, histogram.get_percentile(99));
+    TEST_ASSERT_EQUAL(16001, histogram.get_min());
+    TEST_ASSERT_EQUAL(17000, histogram.get_max());
+}
+
+void test_percentile_bimodal()
+{
+    latency_histogram histogram;
+    for (auto i = 0; i < 500; i++)
+    {
+        histogram.add(16000);
+        histogram.add(24000);
+    }
+
+    TEST_ASSERT_INT_WITHIN(16000 / 16, 16000, histogram.get_percentile(25));
+    TEST_ASSERT_INT_WITHIN(24000 / 16, 24000, histogram.get_percentile(75));
+    TEST_ASSERT_EQUAL(24000, histogram.get_percentile(99));
+}
+
+void test_reset()
+{
+    latency_histogram histogram;
+    histogram.add(1000);
+    histogram.add(5000);
+    histogram.reset();
+    TEST_ASSERT_EQUAL(0, histogram.get_count());
+    TEST_ASSERT_EQUAL(0, histogram.get_min());
+    TEST_ASSERT_EQUAL(0, histogram.get_mean());
+    TEST_ASSERT_EQUAL(0, histogram.get_max());
+    TEST_ASSERT_EQUAL(0, histogram.get_percentile(50));
+
+    // Min must not stick to the values before the reset
+    histogram.add(3000);
+    TEST_ASSERT_EQUAL(3000, histogram.get_min());
+    TEST_ASSERT_EQUAL(3000, histogram.get_percentile(50));
+}
+
+static size_t find_stage(audio_trace_point_t from, audio_trace_point_t to)
+{
+    for (size_t stage = 0; stage < LATENCY_STAGES; stage++)
+        if (audio_latency::stages[stage].from == from && audio_latency::stages[stage].to == to)
+            return stage;
+
+    TEST_FAIL_MESSAGE("Stage not found");
+    return 0;
+}
+
+void test_record()
+{
+    audio_latency latency;
+    audio_trace_t trace;
+    trace.points[TRACE_DMA_COMPLETE] = 1000;
+    trace.points[TRACE_READ] = 1100;
+    trace.points[TRACE_ENQUEUED] = 1300;
+    trace.points[TRACE_DEQUEUED] = 1600;
+    trace.points[TRACE_SENT] = 2000;
+    trace.points[TRACE_PROCESSED] = 2500;
+    latency.record(trace);
+
+    TEST_ASSERT_EQUAL(100, latency.get_histogram(find_stage(TRACE_DMA_COMPLETE, TRACE_READ)).get_max());
+    TEST_ASSERT_EQUAL(300, latency.get_histogram(find_stage(TRACE_ENQUEUED, TRACE_DEQUEUED)).get_max());
+    TEST_ASSERT_EQUAL(500, latency.get_histogram(find_stage(TRACE_SENT, TRACE_PROCESSED)).get_max());
+    TEST_ASSERT_EQUAL(1000, latency.get_histogram(find_stage(TRACE_DMA_COMPLETE, TRACE_SENT)).get_max());
+
+    // Stages not passed are skipped
+    audio_trace_t partial;
+    partial.points[TRACE_DMA_COMPLETE] = 1000;
+    partial.points[TRACE_READ] = 1200;
+    latency.record(partial);
+    TEST_ASSERT_EQUAL(2, latency.get_histogram(find_stage(TRACE_DMA_COMPLETE, TRACE_READ)).get_count());
+    TEST_ASSERT_EQUAL(1, latency.get_histogram(find_stage(TRACE_DMA_COMPLETE, TRACE_SENT)).get_count());
+
+    latency.reset();
+    for (size_t stage = 0; stage < LATENCY_STAGES; stage++)
+        TEST_ASSERT_EQUAL(0, latency.get_histogram(stage).get_count());
+}
+
+void test_dma_ring_tracker()
+{
+    // 3 buffers kept by the driver, 16 ms period
+    dma_ring_tracker ring(3, 16000);
+
+    // Read before its event was seen: the read time is the best estimate
+    TEST_ASSERT_EQUAL(100000, ring.read(100000));
+
+    // Read right after completion
+    ring.completed();
+    TEST_ASSERT_EQUAL(116000, ring.read(116000));
+    TEST_ASSERT_EQUAL(0, ring.get_pending());
+
+    // Two more completed after the one read: it completed two periods before the read
+    ring.completed();
+    ring.completed();
+    ring.completed();
+    TEST_ASSERT_EQUAL(200000 - 2 * 16000, ring.read(200000));
+    TEST_ASSERT_EQUAL(2, ring.get_pending());
+    TEST_ASSERT_EQUAL(200100 - 16000, ring.read(200100));
+    TEST_ASSERT_EQUAL(200200, ring.read(200200));
+    TEST_ASSERT_EQUAL(0, ring.get_pending());
+}
+
+void test_dma_ring_tracker_overflow()
+{
+    dma_ring_tracker ring(3, 16000);
+
+    // Not read for a while (e.g. before the recording task started): the driver keeps only the last 3
+    for (auto i = 0; i < 10; i++)
+        ring.completed();
+
+    TEST_ASSERT_EQUAL(3, ring.get_pending());
+    TEST_ASSERT_EQUAL(500000 - 2 * 16000, ring.read(500000));
+    TEST_ASSERT_EQUAL(500001 - 16000, ring.read(500001));
+    TEST_ASSERT_EQUAL(500002, ring.read(500002));
+
+    // An overflow or error event resyncs to a full ring
+    ring.completed();
+    ring.overflowed();
+    TEST_ASSERT_EQUAL(3, ring.get_pending());
+    TEST_ASSERT_EQUAL(600000 - 2 * 16000, ring.read(600000));
+
+    // Never negative
+    ring.read(600001);
+    ring.read(600002);
+    TEST_ASSERT_EQUAL(600003, ring.read(600003));
+    TEST_ASSERT_EQUAL(0, ring.get_pending());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bucket_boundaries);
+    RUN_TEST(test_empty_histogram);
+    RUN_TEST(test_statistics);
+    RUN_TEST(test_percentile_exact);
+    RUN_TEST(test_percentile_uniform);
+    RUN_TEST(test_percentile_bimodal);
+    RUN_TEST(test_reset);
+    RUN_TEST(test_record);
+    RUN_TEST(test_dma_ring_tracker);
+    RUN_TEST(test_dma_ring_tracker_overflow);
+    return UNITY_END();
+}
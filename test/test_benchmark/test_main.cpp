@@ -0,0 +1,281 @@
+// Host benchmark of the capture -> queue -> send -> process pipeline: pio test -e benchmark -v
+// Models record_task and handle_audio with threads and a bounded queue. The DMA ring is simulated
+// from the clock: a buffer completes every buffer period, at most DMA_RX_BUFFERS are kept.
+// Numbers are host numbers: use them to compare settings, not as ESP32 timings.
+// Processing is a synthetic FFT (radix 2, padded to a power of 2), not the arduinoFFT calls of
+// handle_audio: sent->processed and the throughput show a synthetic processing cost.
+
+#include <unity.h>
+
+#include <audio_latency.h>
+
+#include <chrono>
+#include <complex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <math.h>
+
+// Duration of the real time and of the throughput run per setting
+#ifndef BENCHMARK_SECONDS
+#define BENCHMARK_SECONDS 1.0
+#endif
+
+// Simulated client link speed. 0 is unlimited
+#ifndef BENCHMARK_LINK_BYTES_PER_SECOND
+#define BENCHMARK_LINK_BYTES_PER_SECOND 0
+#endif
+
+typedef struct
+{
+    std::vector<int16_t> samples;
+    audio_trace_t trace;
+} benchmark_buffer_t;
+
+typedef struct
+{
+    uint sample_rate;
+    ushort samples_per_buffer;
+    float seconds_per_buffer;
+    // Real time run
+    audio_latency latency;
+    uint32_t buffers;
+    uint32_t dropped;
+    // Throughput run
+    double samples_per_second;
+} benchmark_result_t;
+
+static int64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void sleep_until_us(int64_t time)
+{
+    auto delay = time - now_us();
+    if (delay > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(delay));
+}
+
+// Bounded queue, blocking like the FreeRTOS sample queue with portMAX_DELAY
+class sample_queue
+{
+private:
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<std::unique_ptr<benchmark_buffer_t>> queue_;
+    size_t length_;
+
+public:
+    sample_queue(size_t length) : length_(length) {}
+
+    void push(std::unique_ptr<benchmark_buffer_t> buffer)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this]
+                      { return queue_.size() < length_; });
+        queue_.push_back(std::move(buffer));
+        changed_.notify_all();
+    }
+
+    std::unique_ptr<benchmark_buffer_t> pop()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this]
+                      { return !queue_.empty(); });
+        auto buffer = std::move(queue_.front());
+        queue_.pop_front();
+        changed_.notify_all();
+        return buffer;
+    }
+};
+
+// Synthetic processing: Hamming window, FFT and peak search like handle_audio, but padded to a power of 2
+static double major_peak(const std::vector<int16_t> &samples, uint sample_rate)
+{
+    size_t size = 1;
+    while (size < samples.size())
+        size <<= 1;
+
+    std::vector<std::complex<double>> data(size);
+    for (size_t i = 0; i < samples.size(); i++)
+        data[i] = samples[i] * (0.54 - 0.46 * cos(2 * M_PI * i / (samples.size() - 1)));
+
+    // Iterative radix 2
+    for (size_t i = 1, j = 0; i < size; i++)
+    {
+        auto bit = size >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+            std::swap(data[i], data[j]);
+    }
+
+    for (size_t length = 2; length <= size; length <<= 1)
+    {
+        auto w_length = std::polar(1.0, -2 * M_PI / length);
+        for (size_t i = 0; i < size; i += length)
+        {
+            std::complex<double> w(1);
+            for (size_t k = 0; k < length / 2; k++)
+            {
+                auto u = data[i + k];
+                auto v = data[i + k + length / 2] * w;
+                data[i + k] = u + v;
+                data[i + k + length / 2] = u - v;
+                w *= w_length;
+            }
+        }
+    }
+
+    size_t peak = 1;
+    for (size_t i = 1; i < size / 2; i++)
+        if (std::abs(data[i]) > std::abs(data[peak]))
+            peak = i;
+
+    return (double)peak * sample_rate / size;
+}
+
+// Model of record_task. Paced: buffers complete in real time, else as fast as they are taken
+static void capture(sample_queue &queue, benchmark_result_t &result, bool paced, int64_t start, int64_t end)
+{
+    const int64_t period = (int64_t)result.samples_per_buffer * 1000000 / result.sample_rate;
+    std::vector<uint16_t> raw_samples(result.samples_per_buffer);
+    uint64_t next = 0;
+    while (now_us() < end)
+    {
+        auto dma_complete = start + (int64_t)(next + 1) * period;
+        if (paced)
+        {
+            sleep_until_us(dma_complete);
+            // The driver keeps DMA_RX_BUFFERS completed buffers. Older ones have been dropped
+            uint64_t completed = (now_us() - start) / period;
+            if (completed > next + DMA_RX_BUFFERS)
+            {
+                result.dropped += completed - DMA_RX_BUFFERS - next;
+                next = completed - DMA_RX_BUFFERS;
+                dma_complete = start + (int64_t)(next + 1) * period;
+            }
+        }
+
+        auto read_time = now_us();
+        std::unique_ptr<benchmark_buffer_t> samples(new benchmark_buffer_t());
+        samples->trace.points[TRACE_DMA_COMPLETE] = paced ? dma_complete : read_time;
+        samples->trace.points[TRACE_READ] = read_time;
+        // Synthetic 1 kHz tone
+        for (size_t i = 0; i < raw_samples.size(); i++)
+            raw_samples[i] = (uint16_t)(8192 * sin(2 * M_PI * 1000 * (next * raw_samples.size() + i) / result.sample_rate));
+        samples->samples.resize(raw_samples.size());
+        for (size_t i = 0; i < raw_samples.size(); i++)
+            samples->samples[i] = (int16_t)(~raw_samples[i] + 1);
+
+        samples->trace.points[TRACE_ENQUEUED] = now_us();
+        queue.push(std::move(samples));
+        next++;
+    }
+
+    // End of run
+    queue.push(nullptr);
+}
+
+// Model of handle_audio
+static void client(sample_queue &queue, benchmark_result_t &result, audio_latency *latency)
+{
+    std::vector<int16_t> socket;
+    while (true)
+    {
+        auto sample_buffer = queue.pop();
+        if (!sample_buffer)
+            break;
+
+        sample_buffer->trace.points[TRACE_DEQUEUED] = now_us();
+        auto send_start = now_us();
+        socket.assign(sample_buffer->samples.begin(), sample_buffer->samples.end());
+#if BENCHMARK_LINK_BYTES_PER_SECOND
+        sleep_until_us(send_start + (int64_t)socket.size() * sizeof(int16_t) * 1000000 / BENCHMARK_LINK_BYTES_PER_SECOND);
+#else
+        (void)send_start;
+#endif
+        sample_buffer->trace.points[TRACE_SENT] = now_us();
+
+        volatile auto peak = major_peak(sample_buffer->samples, result.sample_rate);
+        (void)peak;
+        sample_buffer->trace.points[TRACE_PROCESSED] = now_us();
+        if (latency)
+            latency->record(sample_buffer->trace);
+
+        result.buffers++;
+    }
+}
+
+// Returns the duration of the run in microseconds
+static int64_t run(benchmark_result_t &result, bool paced)
+{
+    sample_queue queue(SAMPLE_BUFFER_NUM_QUEUES);
+    auto start = now_us();
+    std::thread capture_thread(capture, std::ref(queue), std::ref(result), paced, start, start + (int64_t)(BENCHMARK_SECONDS * 1000000));
+    client(queue, result, paced ? &result.latency : nullptr);
+    capture_thread.join();
+    return now_us() - start;
+}
+
+static void benchmark(uint sample_rate)
+{
+    const float seconds_per_buffer[] = {0.008f, 0.016f, 0.032f, 0.064f};
+    printf("\nLatency in microseconds. Throughput with synthetic FFT processing (not arduinoFFT)\n");
+    printf("%6s %8s %7s %8s %15s %15s %15s %8s %22s %9s\n",
+           "rate", "samples", "ms", "buffers", "dma->sent p50", "dma->sent p99", "dma->sent max", "dropped", "max samples/s (synth)", "realtime");
+    // A realtime factor below 1x means the setting can not be sustained: buffers are dropped from the DMA ring
+    for (auto seconds : seconds_per_buffer)
+    {
+        std::unique_ptr<benchmark_result_t> result(new benchmark_result_t());
+        result->sample_rate = sample_rate;
+        result->seconds_per_buffer = seconds;
+        result->samples_per_buffer = sample_rate * seconds;
+        if (result->samples_per_buffer > DMA_MAX_SAMPLES_PER_BUFFER)
+            continue;
+
+        // Latency at the real sample rate
+        run(*result, true);
+        TEST_ASSERT_TRUE(result->buffers > 0);
+
+        // Maximum sustainable throughput: DMA never waits, the slowest stage sets the pace
+        auto buffers_paced = result->buffers;
+        result->buffers = 0;
+        auto duration = run(*result, false);
+        result->samples_per_second = (double)result->buffers * result->samples_per_buffer * 1000000 / duration;
+
+        size_t total = 0;
+        for (size_t stage = 0; stage < LATENCY_STAGES; stage++)
+            if (audio_latency::stages[stage].from == TRACE_DMA_COMPLETE && audio_latency::stages[stage].to == TRACE_SENT)
+                total = stage;
+
+        const auto &histogram = result->latency.get_histogram(total);
+        printf("%6u %8u %7.1f %8u %15lld %15lld %15lld %8u %22.0f %8.1fx\n",
+               sample_rate, result->samples_per_buffer, seconds * 1000, buffers_paced,
+               (long long)histogram.get_percentile(50), (long long)histogram.get_percentile(99), (long long)histogram.get_max(),
+               result->dropped, result->samples_per_second, result->samples_per_second / sample_rate);
+        printf("%s", result->latency.report().c_str());
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_benchmark_8khz() { benchmark(8000); }
+void test_benchmark_16khz() { benchmark(16000); }
+void test_benchmark_48khz() { benchmark(48000); }
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_benchmark_8khz);
+    RUN_TEST(test_benchmark_16khz);
+    RUN_TEST(test_benchmark_48khz);
+    return UNITY_END();
+}